@@ -1,18 +1,27 @@
 #include "TCSM.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
-telComSys::RTSG::RTSG(double prob1) {
+map<string, unsigned> telComSys::_delays;
+
+mutex telComSys::_delaysMtx;
+
+telComSys::RTSG::RTSG(double prob1, unsigned seed) : _dre(seed) {
 	if (prob1 > 1 || prob1 < 0) throw "Error: invalid probability value";
 	_prob1 = prob1;
 	return;
 }
 
-void telComSys::RTSG::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	size_t length = static_cast<size_t>(digTimeSlot / sampInterval); //length of each digit time slot in sample intervals
+void telComSys::RTSG::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval)); //length of each digit time slot in sample intervals
 	if (_prob1 < 1 && _prob1 > 0) {
+		uniform_real_distribution<double> u(0., 1.);
 		for (size_t i = 0; i < s.size(); i += length) {
-			double r = round(((double)rand() / (RAND_MAX)) - 0.5 + _prob1);
+			double r = round(u(_dre) - 0.5 + _prob1);
 			if (!r) r = -1;
 			for (size_t j = 0; j < length; ++j) {
 				s.at(i + j) = r;
@@ -27,71 +36,90 @@ void telComSys::RTSG::runEl(double endTime, double digTimeSlot, double sampInter
 	return;
 }
 
+unsigned telComSys::RTSG::rate(unsigned length) {
+	return 1; //Each digit is a constant level, one sample per slot holds it
+}
+
+void telComSys::RTSG::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	runEl(endTime, symTimeSlot, symTimeSlot, s);
+	return;
+}
 
-telComSys::AWGNG::AWGNG(double sigma) : _deviation(sigma) {};
 
-void telComSys::AWGNG::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
+telComSys::AWGNG::AWGNG(double sigma, double sampInterval, unsigned seed) : _deviation(sigma), _sampInterval(sampInterval), _dre(seed) {};
+
+void telComSys::AWGNG::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
 	if (_deviation == 0) return;
-	unsigned seed = static_cast<unsigned>(rand());
-	default_random_engine dre(seed);
-	normal_distribution<double> noise(0, _deviation);
+	normal_distribution<double> noise(0, _deviation * sqrt(_sampInterval / sampInterval)); //At a lower rate each sample stands for an average of several noise samples
 	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) += noise(dre);
+		s.at(i) += noise(_dre);
 	}
 	return;
 }
 
+unsigned telComSys::AWGNG::rate(unsigned length) {
+	return 0;
+}
 
-telComSys::MDL::MDL(char type) : _type(type) {};
-
-void telComSys::MDL::carrierInit(double endTime, double sampInterval) {
-	_carrier.resize(static_cast<size_t>(endTime / sampInterval));
-	for (size_t i = 0; i < _carrier.size(); ++i) {
-		_carrier.at(i) = sin(i * sampInterval * 4 * _Pi);
+void telComSys::AWGNG::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	if (_deviation == 0) return;
+	//The constellations have unit energy while a real carrier of amplitude 1 has power 1/2,
+	//so each quadrature component gets twice the noise power to keep Eb/N0 the same as in the passband model
+	normal_distribution<double> noise(0, _deviation * sqrt(2 * _sampInterval / sampInterval));
+	for (size_t i = 0; i < cs.size(); ++i) {
+		double re = noise(_dre);
+		cs[i] += complex<double>(re, noise(_dre));
 	}
 	return;
 }
 
-void telComSys::MDL::carriersInitFM(double endTime, double sampInterval) {
-	_carrier.resize(static_cast<size_t>(endTime / sampInterval));
-	for (size_t i = 0; i < _carrier.size(); ++i) {
-		_carrier.at(i) = sin(i * sampInterval * 5 * _Pi);
-	}
-	_carrier2.resize(static_cast<size_t>(endTime / sampInterval));
-	for (size_t i = 0; i < _carrier.size(); ++i) {
-		_carrier2.at(i) = sin(i * sampInterval * 3 * _Pi);
-	}
+
+telComSys::carrier::carrier(double freq) : _freq(freq), _ph(1, 0), _rot(1, 0) {}
+
+void telComSys::carrier::start(double sampInterval) {
+	_rot = polar(1., _freq * sampInterval); //Time, not the sample index, sets the phase, so the rate may change between blocks
+	_ph /= abs(_ph); //Rounding errors of the rotations don't build up in the amplitude
+	return;
+}
+
+telComSys::MDL::MDL(char type, unsigned bits) : _type(type), _carrier(type == 'F' ? 5 * _Pi : 4 * _Pi), _carrier2(3 * _Pi), _bits(bits) {
+	if (type == 'B' || type == 'Q') _points = constellation(bits);
+};
+
+void telComSys::MDL::carrierInit(double sampInterval) {
+	_carrier.start(sampInterval);
+	if (_type == 'F') _carrier2.start(sampInterval);
 	return;
 }
 
-void telComSys::MDL::AM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	carrierInit(endTime, sampInterval);
+void telComSys::MDL::AM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	carrierInit(sampInterval);
 	for (size_t i = 0; i < s.size(); ++i) {
 		s.at(i) += 1;
-		s.at(i) *= 0.5 * _carrier.at(i);
+		s.at(i) *= 0.5 * _carrier.next();
 	}
 	return;
 }
 
-void telComSys::MDL::FM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	carriersInitFM(endTime, sampInterval);
+void telComSys::MDL::FM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	carrierInit(sampInterval);
 	for (size_t i = 0; i < s.size(); ++i) {
 		double tempP = s.at(i);
 		double tempM = -s.at(i);
-		s.at(i) = tempP * _carrier.at(i) + tempM * _carrier2.at(i);
+		s.at(i) = tempP * _carrier.next() + tempM * _carrier2.next();
 	}
 	return;
 }
 
-void telComSys::MDL::PM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	carrierInit(endTime, sampInterval);
+void telComSys::MDL::PM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	carrierInit(sampInterval);
 	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) *= _carrier.at(i);
+		s.at(i) *= _carrier.next();
 	}
 	return;
 }
 
-void telComSys::MDL::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
+void telComSys::MDL::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
 	switch (_type) {
 	case'A':
 		AM(endTime, digTimeSlot, sampInterval, s);
@@ -109,84 +137,105 @@ void telComSys::MDL::runEl(double endTime, double digTimeSlot, double sampInterv
 	return;
 }
 
-telComSys::DMDL::DMDL(char type) : _type(type) {};
-
-void telComSys::DMDL::carrierInit(double endTime, double sampInterval) {
-	_carrier.resize(static_cast<size_t>(endTime / sampInterval));
-	for (size_t i = 0; i < _carrier.size(); ++i) {
-		_carrier.at(i) = sin(i * sampInterval * 4 * _Pi);
+void telComSys::MDL::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	if (_points.empty()) throw "Error: invalid modulation type";
+	size_t length = static_cast<size_t>(round(symTimeSlot / sampInterval)); //Samples per symbol
+	size_t n = s.size() / _bits;
+	cs.resize(n * length);
+	for (size_t i = 0; i < n; ++i) {
+		unsigned v = 0; //Bit pattern of the symbol, first bit is the most significant
+		for (unsigned b = 0; b < _bits; ++b) {
+			v = (v << 1) | (s[i * _bits + b] > 0);
+		}
+		complex<double> p = _points[v];
+		for (size_t j = 0; j < length; ++j) {
+			cs[i * length + j] = p;
+		}
 	}
 	return;
 }
 
-void telComSys::DMDL::carriersInitFM(double endTime, double sampInterval) {
-	_carrier.resize(static_cast<size_t>(endTime / sampInterval));
-	for (size_t i = 0; i < _carrier.size(); ++i) {
-		_carrier.at(i) = sin(i * sampInterval * 5 * _Pi);
-	}
-	_carrier2.resize(static_cast<size_t>(endTime / sampInterval));
-	for (size_t i = 0; i < _carrier.size(); ++i) {
-		_carrier2.at(i) = sin(i * sampInterval * 3 * _Pi);
-	}
+string telComSys::MDL::cfgKey() {
+	return string(1, _type) + to_string(_bits);
+}
+
+telComSys::DMDL::DMDL(char type, unsigned bits) : _type(type), _soft(false), _carrier(type == 'F' ? 5 * _Pi : 4 * _Pi), _carrier2(3 * _Pi), _bits(bits) {};
+
+void telComSys::DMDL::carrierInit(double sampInterval) {
+	_carrier.start(sampInterval);
+	if (_type == 'F') _carrier2.start(sampInterval);
 	return;
 }
 
-void telComSys::DMDL::output(double thresholdLevel, double digTimeSlot, double sampInterval, vector<double>& s) {
-	size_t length = static_cast<size_t>(digTimeSlot / sampInterval);
-	vector<double> temp = s;
-	for (size_t i = 0; i < s.size() - length; i += length) {
+void telComSys::DMDL::output(double thresholdLevel, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	vector<double> last(s.data() + s.size() - length, s.data() + s.size()); //Overwritten below, but integrated in the next block
+	for (size_t i = s.size() - length; i >= length; i -= length) { //Going backwards, the decision for a slot is written over the next one, which is already integrated
 		double sum = -thresholdLevel; //Midpoint Riemann sum is used for integral approximation
-		for (size_t j = 0; j < length; ++j) {
-			sum += (s.at(i + j) + s.at(i + j + 1)) * sampInterval;
-		}
-		if (sum >= 0.5) {
+		if (length == 1) sum += 2 * s.at(i - length) * sampInterval; //At symbol rate the sample already holds the slot average
+		else {
 			for (size_t j = 0; j < length; ++j) {
-				temp.at(i + j + length) = 1;
+				sum += (s.at(i - length + j) + s.at(i - length + j + 1)) * sampInterval;
 			}
 		}
+		decide(sum, s, i, length);
+	}
+	if (_lastSlot.size() == length) { //The stream continues from the previous block, so no slot is lost at the boundary
+		double sum = -thresholdLevel;
+		if (length == 1) sum += 2 * _lastSlot.at(0) * sampInterval;
 		else {
 			for (size_t j = 0; j < length; ++j) {
-				temp.at(i + j + length) = -1;
+				sum += (_lastSlot.at(j) + (j + 1 < length ? _lastSlot.at(j + 1) : s.at(0))) * sampInterval;
 			}
 		}
+		decide(sum, s, 0, length);
+	}
+	_lastSlot.swap(last);
+	return;
+}
+
+void telComSys::DMDL::decide(double sum, sigView s, size_t first, size_t length) {
+	double v = sum >= 0.5 ? 1 : -1;
+	if (_soft) v = sum - 0.5; //The decoder gets the distance from the threshold
+	for (size_t j = 0; j < length; ++j) {
+		s.at(first + j) = v;
 	}
-	s = temp;
 	return;
 }
 
-void telComSys::DMDL::AM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	carrierInit(endTime, sampInterval);
+void telComSys::DMDL::AM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	carrierInit(sampInterval);
 	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) *= _carrier.at(i);
+		s.at(i) *= _carrier.next();
 	}
 	output(0.25, digTimeSlot, sampInterval, s);
 	return;
 }
 
-void telComSys::DMDL::FM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	carriersInitFM(endTime, sampInterval);
+void telComSys::DMDL::FM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	carrierInit(sampInterval);
 	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) *= _carrier.at(i) - _carrier2.at(i);
+		s.at(i) *= _carrier.next() - _carrier2.next();
 	}
 	output(0., digTimeSlot, sampInterval, s);
 	return;
 }
 
-void telComSys::DMDL::PM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	carrierInit(endTime, sampInterval);
+void telComSys::DMDL::PM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	carrierInit(sampInterval);
 	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) *= _carrier.at(i);
+		s.at(i) *= _carrier.next();
 	}
 	output(0., digTimeSlot, sampInterval, s);
 	return;
 }
 
-void telComSys::DMDL::pM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
+void telComSys::DMDL::pM(double endTime, double digTimeSlot, double sampInterval, sigView s) {
 	output(0., digTimeSlot, sampInterval, s);
 	return;
 }
 
-void telComSys::DMDL::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
+void telComSys::DMDL::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
 	switch (_type) {
 	case'A':
 		AM(endTime, digTimeSlot, sampInterval, s);
@@ -207,95 +256,888 @@ void telComSys::DMDL::runEl(double endTime, double digTimeSlot, double sampInter
 	return;
 }
 
+string telComSys::DMDL::cfgKey() {
+	return string(1, _type) + to_string(_bits);
+}
 
-telComSys::ERC::ERC(unsigned delay, vector<double> initS) : _delay(delay), _cnt(0) {
-	_initS = initS;
+unsigned telComSys::DMDL::rate(unsigned length) {
+	return _type == 'p' ? 1 : length; //Only the low-frequency demodulator works without the carrier
 }
 
-void telComSys::ERC::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	_cnt = 0;
-	size_t length = static_cast<size_t>(digTimeSlot / sampInterval);
-	for (size_t i = 0; i < s.size() - _delay * length; ++i) {
-		if (s.at(i + _delay * length) != _initS.at(i)) _cnt++;
+void telComSys::DMDL::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	size_t length = static_cast<size_t>(round(symTimeSlot / sampInterval));
+	size_t n = cs.size() / length;
+	if (_type == 'B') {
+		for (size_t i = 0; i < n; ++i) {
+			double sum = 0;
+			for (size_t j = 0; j < length; ++j) {
+				sum += cs[i * length + j].real();
+			}
+			s[i] = _soft ? sum / length : (sum >= 0 ? 1 : -1);
+		}
+		return;
+	}
+	if (_type != 'Q') throw "Error: invalid modulation type";
+	unsigned h = _bits / 2; //Bits per quadrature component
+	int levels = 1 << h;
+	double step = sqrt(1.5 / ((1 << _bits) - 1)); //Half the distance between neighbouring levels, same scaling as in constellation()
+	for (size_t i = 0; i < n; ++i) {
+		complex<double> sum = 0;
+		for (size_t j = 0; j < length; ++j) {
+			sum += cs[i * length + j];
+		}
+		sum /= static_cast<double>(length);
+		if (_soft && _bits == 2) { //Each QPSK bit is carried by its own component
+			s[2 * i] = sum.real();
+			s[2 * i + 1] = sum.imag();
+			continue;
+		}
+		int re = static_cast<int>(floor(sum.real() / (2 * step) + levels / 2.)); //Level index is found directly, no search over the points
+		int im = static_cast<int>(floor(sum.imag() / (2 * step) + levels / 2.));
+		re = re < 0 ? 0 : (re >= levels ? levels - 1 : re);
+		im = im < 0 ? 0 : (im >= levels ? levels - 1 : im);
+		unsigned v = (static_cast<unsigned>(re ^ (re >> 1)) << h) | static_cast<unsigned>(im ^ (im >> 1));
+		for (unsigned b = 0; b < _bits; ++b) {
+			s[i * _bits + b] = (v >> (_bits - 1 - b)) & 1 ? 1 : -1;
+		}
 	}
-	cout << "Number of errors: " << _cnt / length << endl; //Since counter is incremented for each sample interval we need to divide it by length
 	return;
 }
 
-telComSys::MPCH::MPCH(unsigned num, vector<double> coeffs) : _num(num) {
-	_gammas = coeffs;
-};
 
-void telComSys::MPCH::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	_sig.resize(_num);
-	size_t length = static_cast<size_t>(digTimeSlot / sampInterval);
-	for (size_t i = 0; i < _num; ++i) {
-		_sig.at(i).resize(s.size() + i * length); //Initializing each path signal with zeros
-		for (auto j : _sig.at(i)) {
-			j = 0;
+telComSys::ERC::ERC(unsigned delay, const vector<double>& initS, const vector<double>& infoS, const vector<double>& preS, unsigned bps, bool est, bool coded) : _cnt(0), _delay(delay), _initS(initS), _infoS(infoS), _preS(preS), _preCnt(0), _preN(0), _n(0), _bps(bps), _symCnt(0), _est(est), _coded(coded), _base(0) {}
+
+void telComSys::ERC::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	_cnt = 0;
+	_symCnt = 0;
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	size_t slots = s.size() / length;
+	if (_coded) { //Channel coding: the decoder has already aligned the digits
+		_preCnt = 0;
+		_preN = min(_preS.size(), _initS.size());
+		for (size_t i = 0; i < _preN; ++i) {
+			if (_preS[i] != _initS[i]) _preCnt++;
 		}
-	}
-	for (size_t i = 0; i < _num; ++i) {
-		for (size_t j = 0; j < s.size(); ++j) {
-			_sig.at(i).at(j + i * length) = s.at(j); //Filling each path signal considering the delay
+		_n = min(_infoS.size(), slots);
+		for (size_t j = 0; j < _n; ++j) {
+			if (s.at(j * length) != _infoS[j]) _cnt++;
 		}
+		return;
 	}
-	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) = 0;
-		for (size_t j = 0; j < _sig.size(); ++j) {
-			s.at(i) += _sig.at(j).at(i) * _gammas.at(j); //Getting the resulting signal considering the coefficients of each path
+	if (_initS.size() < slots) throw "Error: no initial signal for error counter";
+	if (_est) cachedDelay(_key, _initS, s, length, _delay); //The delay depends only on the chain configuration, so a reliable estimate is kept for each
+	size_t p = _pend.size(), last = SIZE_MAX; //Last symbol counted as erroneous
+	size_t first = p < _delay ? _delay - p : 0; //First slot whose reference digit is known
+	_n = slots > first ? slots - first : 0;
+	for (size_t j = first; j < slots; ++j) { //The reference is the pending digits followed by this block's, one sample per slot
+		size_t i = j + p - _delay;
+		if (s.at(j * length) != (i < p ? _pend[i] : _initS.at(i - p))) {
+			_cnt++;
+			if ((_base + i) / _bps != last) {
+				last = (_base + i) / _bps;
+				_symCnt++;
+			}
 		}
 	}
+	size_t keep = min<size_t>(_delay, p + slots); //The last _delay reference digits are compared in the next block
+	if (keep <= slots) _pend.assign(_initS.begin() + (slots - keep), _initS.begin() + slots);
+	else {
+		_pend.erase(_pend.begin(), _pend.begin() + (p + slots - keep));
+		_pend.insert(_pend.end(), _initS.begin(), _initS.begin() + slots);
+	}
+	_base += p + slots - keep;
+	return;
+}
+
+void telComSys::ERC::print() {
+	if (_coded) {
+		cout << "Errors before decoding: " << _preCnt << " (rate " << (_preN ? static_cast<double>(_preCnt) / _preN : 0.) << ')' << endl;
+		cout << "Number of errors: " << _cnt << " (rate " << (_n ? static_cast<double>(_cnt) / _n : 0.) << ')' << endl;
+		return;
+	}
+	if (_est) cout << "Estimated delay: " << _delay << endl;
+	cout << "Number of errors: " << _cnt << endl;
+	if (_bps > 1) cout << "Number of symbol errors: " << _symCnt << endl;
 	return;
 }
 
+unsigned telComSys::ERC::rate(unsigned length) {
+	return 1;
+}
+
+void telComSys::ERC::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	runEl(endTime, symTimeSlot, symTimeSlot, s);
+	return;
+}
 
-telComSys::CRTR::CRTR(char type, unsigned num, vector<double> coeffs) : _type(type), _num(num) {
+telComSys::MPCH::MPCH(unsigned num, vector<double> coeffs) : _num(num), _pos(0), _length(0) {
 	_gammas = coeffs;
 };
 
-void telComSys::CRTR::recCRTR(size_t length, vector<double>& s, double val, unsigned depth) {
-	if (depth * length >= s.size()) return;
-	double temp = val;
-	val += s.at(depth * length); //Val represents the current value in corrector
-	val *= -(_gammas.at(1) / _gammas.at(0));
-	for (size_t i = 0; i < length; ++i) {
-		s.at(depth * length + i) += temp;
-		s.at(depth * length + i) /= _gammas.at(0);
+void telComSys::MPCH::history(size_t length) {
+	if (length == _length) return;
+	_hist.assign((_num ? _num - 1 : 0) * length + 1, 0.);
+	_pos = 0;
+	_length = length;
+	return;
+}
+
+void telComSys::MPCH::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	history(length); //The delayed paths continue from the previous block
+	size_t hs = _hist.size();
+	for (size_t i = 0; i < s.size(); ++i) {
+		_pos = _pos + 1 == hs ? 0 : _pos + 1;
+		_hist[_pos] = s[i];
+		double sum = 0;
+		for (size_t j = 0, d = 0; j < _num; ++j, d += length) {
+			sum += _hist[_pos >= d ? _pos - d : _pos + hs - d].real() * _gammas.at(j); //Path j is delayed by j slots
+		}
+		s[i] = sum;
 	}
-	depth++;
-	recCRTR(length, s, val, depth);
+	return;
 }
 
-void telComSys::CRTR::nrCRTR(size_t length, vector<double>& s) {
-	_sig.resize(_num + 1);
-	for (size_t i = 0; i <= _num; ++i) {
-		_sig.at(i).resize(s.size() + i * length);
-		for (auto j : _sig.at(i)) {
-			j = 0;
+string telComSys::MPCH::cfgKey() {
+	string key;
+	for (auto g : _gammas) key += to_string(g) + ',';
+	return key;
+}
+
+unsigned telComSys::MPCH::rate(unsigned length) {
+	return 0; //Path delays are whole slots, so the channel works at any rate
+}
+
+void telComSys::MPCH::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	size_t length = static_cast<size_t>(round(symTimeSlot / sampInterval));
+	history(length);
+	size_t hs = _hist.size();
+	for (size_t i = 0; i < cs.size(); ++i) {
+		_pos = _pos + 1 == hs ? 0 : _pos + 1;
+		_hist[_pos] = cs[i];
+		complex<double> sum = 0;
+		for (size_t j = 0, d = 0; j < _num; ++j, d += length) {
+			sum += _hist[_pos >= d ? _pos - d : _pos + hs - d] * _gammas.at(j);
+		}
+		cs[i] = sum;
+	}
+	return;
+}
+
+
+telComSys::CRTR::CRTR(char type, unsigned num, vector<double> coeffs) : _type(type), _num(num), _val(0), _pos(0), _length(0) {
+	_gammas = coeffs;
+};
+
+void telComSys::CRTR::recCRTR(size_t length, sigView s) {
+	for (size_t i = 0; i < s.size(); i += length) { //_val carries the corrector state over to the next block
+		double temp = _val;
+		_val += s.at(i);
+		_val *= -(_gammas.at(1) / _gammas.at(0));
+		for (size_t j = i; j < i + length && j < s.size(); ++j) {
+			s.at(j) += temp;
+			s.at(j) /= _gammas.at(0);
 		}
 	}
+	return;
+}
+
+void telComSys::CRTR::nrCRTR(size_t length, sigView s) {
 	double k = _gammas.at(0) / _gammas.at(1);
+	vector<double> w(_num + 1); //Weight of each branch, branch i is delayed by i slots
 	for (size_t i = 0; i <= _num; ++i) {
-		for (size_t j = 0; j < s.size(); ++j) {
-			_sig.at(i).at(j + i * length) += s.at(j) * pow((-k), _num - i);
-		}
+		w.at(i) = pow((-k), _num - i) / _gammas.at(1);
+	}
+	if (length != _length) { //Delay line of the branches, continued from the previous block
+		_hist.assign(_num * length + 1, 0.);
+		_pos = 0;
+		_length = length;
 	}
+	size_t hs = _hist.size();
 	for (size_t i = 0; i < s.size(); ++i) {
-		s.at(i) = 0;
-		for (size_t j = 0; j < _sig.size(); ++j) {
-			s.at(i) += _sig.at(j).at(i) / _gammas.at(1);
+		_pos = _pos + 1 == hs ? 0 : _pos + 1;
+		_hist[_pos] = s[i];
+		double sum = 0;
+		for (size_t j = 0, d = 0; j <= _num; ++j, d += length) {
+			sum += _hist[_pos >= d ? _pos - d : _pos + hs - d] * w[j];
 		}
+		s[i] = sum;
 	}
 	return;
 }
 
-void telComSys::CRTR::runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) {
-	size_t length = static_cast<size_t>(digTimeSlot / sampInterval);
+void telComSys::CRTR::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
 	_type == 'R' ? recCRTR(length, s) : nrCRTR(length, s);
 	return;
 }
 
+string telComSys::CRTR::cfgKey() {
+	string key = string(1, _type) + to_string(_num) + ',';
+	for (auto g : _gammas) key += to_string(g) + ',';
+	return key;
+}
+
+unsigned telComSys::CRTR::rate(unsigned length) {
+	return _type == 'R' ? length : 0; //The recursive corrector feeds back the first sample of each slot, not the slot average
+}
+
+telComSys::SPAN::SPAN(size_t size, double overlap) : _size(size), _segs(0), _sampInterval(0), _cplx(false) {
+	if (size < 2 || (size & (size - 1))) throw "Error: FFT size must be a power of 2";
+	if (overlap < 0 || overlap >= 1) throw "Error: invalid segment overlap";
+	_hop = size - static_cast<size_t>(round(overlap * size));
+	if (!_hop) _hop = 1;
+	_window.resize(size);
+	for (size_t i = 0; i < size; ++i) {
+		_window.at(i) = 0.5 - 0.5 * cos(2 * _Pi * i / size);
+	}
+	_buf.resize(size);
+	_acc.assign(size / 2 + 1, 0.);
+}
+
+void telComSys::SPAN::restart(double sampInterval, bool cplx) {
+	if (abs(sampInterval - _sampInterval) > 0.000001 || cplx != _cplx) {
+		_acc.assign(cplx ? _size : _size / 2 + 1, 0.); //Previous periodograms are not comparable
+		_segs = 0;
+		_tail.clear();
+	}
+	_sampInterval = sampInterval;
+	_cplx = cplx;
+	return;
+}
+
+void telComSys::SPAN::accumulate(const double* x, const complex<double>* cx, size_t n) {
+	size_t t = _tail.size(), i = 0; //Segment starts are counted from the first sample of the tail
+	for (; i + _size <= t + n; i += _hop) { //Segments are processed one at a time, only the periodogram sum is kept
+		size_t k = i < t ? t - i : 0; //Samples of the segment still in the tail, the rest is read from the block directly
+		for (size_t j = 0; j < k; ++j) {
+			_buf[j] = _tail[i + j] * _window[j];
+		}
+		if (cx) for (size_t j = k; j < _size; ++j) _buf[j] = cx[i + j - t] * _window[j];
+		else for (size_t j = k; j < _size; ++j) _buf[j] = x[i + j - t] * _window[j];
+		fft(_buf);
+		for (size_t j = 0; j < _acc.size(); ++j) {
+			_acc[j] += norm(_buf[j]);
+		}
+		_segs++;
+	}
+	size_t from = i > t ? i - t : 0; //Segments crossing into the next block are completed then
+	if (i < t) _tail.erase(_tail.begin(), _tail.begin() + i);
+	else _tail.clear();
+	if (cx) _tail.insert(_tail.end(), cx + from, cx + n);
+	else _tail.insert(_tail.end(), x + from, x + n);
+	return;
+}
+
+void telComSys::SPAN::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	restart(sampInterval, false);
+	accumulate(s.data(), nullptr, s.size());
+	return;
+}
+
+unsigned telComSys::SPAN::rate(unsigned length) {
+	return length; //The spectrum is measured on the full-rate signal
+}
+
+void telComSys::SPAN::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	restart(sampInterval, true);
+	accumulate(nullptr, cs.data(), cs.size());
+	return;
+}
+
+vector<pair<double, double>> telComSys::SPAN::bins() {
+	vector<pair<double, double>> res;
+	if (!_segs) return res;
+	double u = 0; //Window power
+	for (auto w : _window) u += w * w;
+	double scale = _sampInterval / (u * _segs);
+	if (_cplx) { //Two-sided spectrum, from the most negative frequency
+		for (size_t k = 0; k < _size; ++k) {
+			size_t i = (k + _size / 2) % _size;
+			double f = (static_cast<double>(i) - (i >= _size / 2 ? _size : 0)) / (_size * _sampInterval);
+			res.push_back(pair<double, double>(f, _acc.at(i) * scale));
+		}
+		return res;
+	}
+	for (size_t i = 0; i < _acc.size(); ++i) {
+		double p = _acc.at(i) * scale;
+		if (i != 0 && i != _acc.size() - 1) p *= 2; //One-sided spectrum, negative frequencies are folded in
+		res.push_back(pair<double, double>(i / (_size * _sampInterval), p));
+	}
+	return res;
+}
+
+void telComSys::SPAN::print() {
+	if (!_segs) {
+		cout << "Power spectral density: not enough samples for one segment yet" << endl;
+		return;
+	}
+	cout << "Power spectral density (" << _segs << " segments):" << endl;
+	for (auto& b : bins()) cout << "f = " << b.first << "\tP = " << b.second << endl;
+	return;
+}
+
+bool telComSys::estDelay(const vector<double>& initS, sigView s, size_t length, unsigned& delay) {
+	size_t slots = s.size() / length;
+	delay = 0;
+	if (slots < 2 || initS.size() < slots) return false;
+	size_t win = min<size_t>(slots / 2, 4096); //Prefix of the initial signal which is searched for in the output
+	size_t maxLag = min<size_t>(slots - win, 1024);
+	size_t n = 1;
+	while (n < win + maxLag) n <<= 1;
+	double meanRef = 0, meanOut = 0;
+	for (size_t i = 0; i < win; ++i) meanRef += initS[i];
+	for (size_t i = 0; i < win + maxLag; ++i) meanOut += s[i * length];
+	meanRef /= win;
+	meanOut /= win + maxLag;
+	vector<complex<double>> ref(n), out(n);
+	for (size_t i = 0; i < win; ++i) ref[i] = initS[i] - meanRef;
+	for (size_t i = 0; i < win + maxLag; ++i) out[i] = s[i * length] - meanOut; //One sample per slot is enough
+	fft(ref);
+	fft(out);
+	for (size_t i = 0; i < n; ++i) out[i] *= conj(ref[i]);
+	fft(out, true); //out[d] is now the correlation at lag d
+	size_t best = 0;
+	for (size_t d = 1; d <= maxLag; ++d) {
+		if (out[d].real() > out[best].real()) best = d;
+	}
+	delay = static_cast<unsigned>(best);
+	double second = 0; //Highest correlation away from the peak and its neighbours
+	for (size_t d = 0; d <= maxLag; ++d) {
+		if (d + 1 < best || d > best + 1) second = max(second, out[d].real());
+	}
+	double eRef = 0, eOut = 0;
+	for (size_t i = 0; i < win; ++i) {
+		double v = s[(i + best) * length] - meanOut;
+		eRef += (initS[i] - meanRef) * (initS[i] - meanRef);
+		eOut += v * v;
+	}
+	double peak = out[best].real();
+	return win >= 32 && peak > 2 * second && peak > 0.25 * sqrt(eRef * eOut); //Noise or a too short block gives no clear peak
+}
+
+bool telComSys::cachedDelay(const string& key, const vector<double>& initS, sigView s, size_t length, unsigned& delay) {
+	unique_lock<mutex> lock(_delaysMtx);
+	auto it = _delays.find(key);
+	if (it != _delays.end()) {
+		delay = it->second;
+		return true;
+	}
+	lock.unlock(); //Other threads aren't blocked by the estimation
+	if (!estDelay(initS, s, length, delay)) return false; //Estimated again next time
+	lock.lock();
+	_delays[key] = delay;
+	return true;
+}
+
+void telComSys::clearDelays() {
+	lock_guard<mutex> lock(_delaysMtx);
+	_delays.clear();
+	return;
+}
+
+unsigned telComSys::parity(unsigned x) {
+	x ^= x >> 16;
+	x ^= x >> 8;
+	x ^= x >> 4;
+	x ^= x >> 2;
+	x ^= x >> 1;
+	return x & 1;
+}
+
+vector<complex<double>> telComSys::constellation(unsigned bits) {
+	vector<complex<double>> points(static_cast<size_t>(1) << bits);
+	if (bits == 1) {
+		points[0] = -1;
+		points[1] = 1;
+		return points;
+	}
+	if (bits % 2) throw "Error: only square QAM constellations are supported";
+	unsigned h = bits / 2;
+	int levels = 1 << h;
+	double step = sqrt(1.5 / (points.size() - 1)); //Makes the average symbol energy equal to 1
+	vector<double> amp(static_cast<size_t>(levels)); //Amplitude for each Gray-coded bit pattern of one component
+	for (int i = 0; i < levels; ++i) {
+		amp[static_cast<size_t>(i ^ (i >> 1))] = (2 * i - levels + 1) * step;
+	}
+	for (size_t v = 0; v < points.size(); ++v) {
+		points[v] = complex<double>(amp[v >> h], amp[v & (levels - 1)]);
+	}
+	return points;
+}
+
+void telComSys::fft(vector<complex<double>>& a, bool inverse) {
+	size_t n = a.size();
+	for (size_t i = 1, j = 0; i < n; ++i) { //Bit-reversal permutation
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1) j ^= bit;
+		j ^= bit;
+		if (i < j) swap(a[i], a[j]);
+	}
+	for (size_t len = 2; len <= n; len <<= 1) {
+		double ang = 2 * _Pi / len * (inverse ? 1 : -1);
+		complex<double> wl(cos(ang), sin(ang));
+		for (size_t i = 0; i < n; i += len) {
+			complex<double> w(1);
+			for (size_t j = 0; j < len / 2; ++j) {
+				complex<double> u = a[i + j];
+				complex<double> v = a[i + j + len / 2] * w;
+				a[i + j] = u + v;
+				a[i + j + len / 2] = u - v;
+				w *= wl;
+			}
+		}
+	}
+	if (inverse) {
+		for (auto& x : a) x /= static_cast<double>(n);
+	}
+	return;
+}
+
+telComSys::FSRC::FSRC(const char* sigPath, const char* refPath, vector<double>& initS) : _sig(sigPath), _pos(0), _end(false), _initS(initS), _paths(string(sigPath) + '|' + (refPath ? refPath : "")) {
+	if (refPath) _ref.reset(new mappedFile(refPath));
+}
+
+void telComSys::FSRC::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	size_t slots = s.size() / length;
+	unsigned long long total = _sig.size() / sizeof(double) / length; //Whole slots in the recording
+	size_t n = static_cast<size_t>(min<unsigned long long>(slots, total > _pos ? total - _pos : 0));
+	const char* p = _sig.view(_pos * length * sizeof(double), n * length * sizeof(double)); //Only the current block is mapped
+	if (n) memcpy(s.data(), p, n * length * sizeof(double));
+	fill(s.data() + n * length, s.data() + s.size(), 0.); //The last block is padded with zeros
+	if (_ref) {
+		size_t m = static_cast<size_t>(min<unsigned long long>(slots, _ref->size() > _pos ? _ref->size() - _pos : 0));
+		const char* r = _ref->view(_pos, m);
+		_initS.assign(slots, -1);
+		for (size_t i = 0; i < m; ++i) {
+			_initS[i] = r[i] ? 1 : -1;
+		}
+	}
+	_pos += slots;
+	_end = _pos >= total;
+	return;
+}
+
+string telComSys::FSRC::cfgKey() {
+	return _paths;
+}
+
+telComSys::FDCH::FDCH(vector<double> coeffs, double doppler, double kFactor, unsigned seed, unsigned sins) : _gammas(coeffs), _doppler(doppler), _kFactor(kFactor), _sins(sins), _step(0), _steps(0), _pos(0), _length(0) {
+	if (coeffs.empty() || !sins) throw "Error: fading channel needs at least one path";
+	if (doppler < 0 || kFactor < 0) throw "Error: invalid fading parameters";
+	default_random_engine dre(seed);
+	uniform_real_distribution<double> u(0., 2 * _Pi);
+	_freq.resize(coeffs.size() * 2 * sins);
+	_osc.resize(_freq.size());
+	for (size_t p = 0; p < coeffs.size(); ++p) {
+		double theta = u(dre);
+		for (unsigned n = 0; n < sins; ++n) {
+			double alpha = (2 * _Pi * (n + 1) - _Pi + theta) / (4 * sins); //Arrival angles, different for each path
+			size_t i = (p * sins + n) * 2;
+			_freq[i] = 2 * _Pi * doppler * cos(alpha); //In-phase oscillator
+			_freq[i + 1] = 2 * _Pi * doppler * sin(alpha); //Quadrature oscillator
+			_osc[i] = polar(1., u(dre));
+			_osc[i + 1] = polar(1., u(dre));
+		}
+	}
+}
+
+void telComSys::FDCH::gains(vector<complex<double>>& g) {
+	g.resize(_gammas.size());
+	double scatter = sqrt(1. / _sins); //Each quadrature component gets power 1/2
+	for (size_t p = 0; p < _gammas.size(); ++p) {
+		double re = 0, im = 0;
+		for (unsigned n = 0; n < _sins; ++n) {
+			re += _osc[(p * _sins + n) * 2].real();
+			im += _osc[(p * _sins + n) * 2 + 1].real();
+		}
+		complex<double> h(re * scatter, im * scatter);
+		if (p == 0 && _kFactor > 0) h = sqrt(_kFactor / (_kFactor + 1)) + h * sqrt(1 / (_kFactor + 1)); //Line of sight component
+		g[p] = h * _gammas[p];
+	}
+	return;
+}
+
+void telComSys::FDCH::advance(double step) {
+	if (step != _step) {
+		_rot.resize(_freq.size());
+		for (size_t i = 0; i < _freq.size(); ++i) {
+			_rot[i] = polar(1., _freq[i] * step);
+		}
+		_step = step;
+	}
+	for (size_t i = 0; i < _osc.size(); ++i) {
+		_osc[i] *= _rot[i];
+	}
+	if (++_steps == 1024) { //Keeps rounding errors from changing the amplitudes
+		for (auto& o : _osc) o /= abs(o);
+		_steps = 0;
+	}
+	gains(_gEnd);
+	return;
+}
+
+size_t telComSys::FDCH::blockSize(double sampInterval) {
+	if (_doppler * sampInterval * 64 <= 1. / 32) return 64;
+	size_t b = static_cast<size_t>(1. / (32 * _doppler * sampInterval)); //Oscillators turn by at most 1/32 of a cycle over a block, so linear interpolation stays accurate
+	return b ? b : 1;
+}
+
+void telComSys::FDCH::history(size_t length) {
+	if (length == _length) return;
+	_hist.assign((_gammas.size() - 1) * length + 1, 0.);
+	_pos = 0;
+	_length = length;
+	if (_g.empty()) gains(_g);
+	return;
+}
+
+void telComSys::FDCH::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	history(length);
+	size_t paths = _gammas.size(), hs = _hist.size(), block = blockSize(sampInterval);
+	vector<double> a(paths), da(paths);
+	for (size_t i = 0; i < s.size(); i += block) {
+		size_t b = min(block, s.size() - i);
+		advance(b * sampInterval);
+		for (size_t p = 0; p < paths; ++p) { //Envelope of the fading times the path coefficient, which keeps its sign
+			double sign = _gammas[p] < 0 ? -1 : 1;
+			a[p] = sign * abs(_g[p]);
+			da[p] = (sign * abs(_gEnd[p]) - a[p]) / b;
+		}
+		for (size_t j = i; j < i + b; ++j) { //Each path costs one multiply-add and one gain increment per sample
+			_pos = _pos + 1 == hs ? 0 : _pos + 1;
+			_hist[_pos] = s[j];
+			double sum = 0;
+			for (size_t p = 0, d = 0; p < paths; ++p, d += length) {
+				sum += a[p] * _hist[_pos >= d ? _pos - d : _pos + hs - d].real();
+				a[p] += da[p];
+			}
+			s[j] = sum;
+		}
+		_g.swap(_gEnd);
+	}
+	return;
+}
+
+unsigned telComSys::FDCH::rate(unsigned length) {
+	return 0;
+}
+
+void telComSys::FDCH::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	size_t length = static_cast<size_t>(round(symTimeSlot / sampInterval));
+	history(length);
+	size_t paths = _gammas.size(), hs = _hist.size(), block = blockSize(sampInterval);
+	vector<complex<double>> g(paths), dg(paths);
+	for (size_t i = 0; i < cs.size(); i += block) {
+		size_t b = min(block, cs.size() - i);
+		advance(b * sampInterval);
+		for (size_t p = 0; p < paths; ++p) {
+			g[p] = _g[p];
+			dg[p] = (_gEnd[p] - _g[p]) / static_cast<double>(b);
+		}
+		for (size_t j = i; j < i + b; ++j) {
+			_pos = _pos + 1 == hs ? 0 : _pos + 1;
+			_hist[_pos] = cs[j];
+			complex<double> sum = 0;
+			for (size_t p = 0, d = 0; p < paths; ++p, d += length) {
+				sum += g[p] * _hist[_pos >= d ? _pos - d : _pos + hs - d];
+				g[p] += dg[p];
+			}
+			cs[j] = sum;
+		}
+		_g.swap(_gEnd);
+	}
+	return;
+}
+
+string telComSys::FDCH::cfgKey() {
+	string key = to_string(_kFactor) + ',';
+	for (auto g : _gammas) key += to_string(g) + ',';
+	return key;
+}
+
+telComSys::CNVE::CNVE(vector<double>& infoS, unsigned frame) : _infoS(infoS), _sr(0), _frame(frame), _cnt(0), _pend(0) {}
+
+void telComSys::CNVE::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	size_t slots = s.size() / length;
+	vector<double> in(slots); //The slots are overwritten faster than the digits are read
+	for (size_t j = 0; j < slots; ++j) {
+		in[j] = s.at(j * length);
+	}
+	_infoS.clear();
+	size_t pos = 0, j = 0;
+	if (_pend != 0) { //Finishes the last step of the previous block
+		for (size_t k = 0; k < length; ++k) {
+			s.at(k) = _pend;
+		}
+		pos = 1;
+		_pend = 0;
+	}
+	while (pos < slots) {
+		unsigned b = 0; //Tail digits are zeros, they bring the encoder back to the zero state
+		if (!_frame || _cnt < _frame) {
+			b = in.at(j) > 0 ? 1 : 0;
+			_infoS.push_back(in.at(j++));
+		}
+		if (_frame && ++_cnt == _frame + 6) _cnt = 0;
+		_sr = ((_sr << 1) | b) & 0x7F;
+		double c0 = parity(_sr & 0133) ? 1 : -1, c1 = parity(_sr & 0171) ? 1 : -1;
+		for (size_t k = 0; k < length; ++k) {
+			s.at(pos * length + k) = c0;
+		}
+		if (++pos == slots) {
+			_pend = c1;
+			break;
+		}
+		for (size_t k = 0; k < length; ++k) {
+			s.at(pos * length + k) = c1;
+		}
+		++pos;
+	}
+	for (size_t i = slots * length; i < s.size(); ++i) {
+		s.at(i) = -1;
+	}
+	return;
+}
+
+unsigned telComSys::CNVE::rate(unsigned length) {
+	return 1;
+}
+
+void telComSys::CNVE::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	runEl(endTime, symTimeSlot, symTimeSlot, s);
+	return;
+}
+
+telComSys::VTBD::VTBD(const vector<double>& initS, vector<double>& infoS, vector<double>& preS, unsigned frame, size_t depth, size_t chunk) : _depth(depth), _chunk(chunk), _frame(frame), _flush(false), _started(false), _delay(0), _half(-1), _absSum(0), _absN(0), _initS(initS), _infoS(infoS), _preS(preS) {
+	if (!chunk) throw "Error: invalid traceback parameters";
+	for (unsigned i = 0; i < 32; ++i) { //Expected digits for the transition from state i to 2i, the other three branches of the butterfly follow from it
+		_bi[i] = static_cast<unsigned char>(2 * parity((2 * i) & 0133) + parity((2 * i) & 0171));
+	}
+	for (unsigned p = 0; p < 1024; ++p) { //Byte e of the entry is the distance to the expected digits 2 * e0 + e1, a certain '0' is level 0
+		unsigned s0 = p >> 5, s1 = p & 31;
+		_bm[p] = (s0 + s1) | ((s0 + 31 - s1) << 8) | ((31 - s0 + s1) << 16) | ((62 - s0 - s1) << 24);
+	}
+	_dec.resize(depth + chunk);
+	reset();
+}
+
+unsigned char telComSys::VTBD::level(double x, double scale) {
+	double v = 16 + x * scale;
+	return static_cast<unsigned char>((abs(v) - abs(v - 31) + 31) * 0.5); //Clamped to 0-31 without branches (min and max are compiled to jumps), the values are random
+}
+
+void telComSys::VTBD::reset() {
+	_metric[0] = 0; //The encoder starts from the zero state
+	for (size_t i = 1; i < 64; ++i) _metric[i] = 255;
+	_base = 0;
+	_t = 0;
+	_done = 0;
+	return;
+}
+
+void telComSys::VTBD::acs(const unsigned char* q, size_t steps) {
+	uint64_t* dec = _dec.data() + _t % _dec.size(); //The caller keeps the steps within the ring
+	const size_t t = _t; //Local copy, the decision stores could alias the member
+	//Every second step the minimum of two steps ago is subtracted, which keeps the horizontal minimum out of the dependency chain
+	//of the steps. Branch metrics are at most 62, so a metric saturates only when its state is far behind the best one and its
+	//path is lost anyway (the error rate is the same as with the minimum subtracted exactly at every step)
+#ifdef __AVX2__
+	__m256i m0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_metric)); //States 0-31
+	__m256i m1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_metric + 32)); //States 32-63
+	__m256i base = _mm256_set1_epi8(static_cast<char>(_base));
+	const __m256i bi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_bi));
+	const __m256i max = _mm256_set1_epi8(62);
+	for (size_t i = 0; i < steps; ++i) {
+		__m256i m = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(_bm[(q[2 * i] << 5) | q[2 * i + 1]])), bi); //Butterfly k: states k and k + 32 to 2k and 2k + 1
+		__m256i mc = _mm256_sub_epi8(max, m);
+		__m256i a0 = _mm256_adds_epu8(m0, m), b0 = _mm256_adds_epu8(m1, mc);
+		__m256i a1 = _mm256_adds_epu8(m0, mc), b1 = _mm256_adds_epu8(m1, m);
+		__m256i e = _mm256_min_epu8(a0, b0), o = _mm256_min_epu8(a1, b1);
+		uint32_t d0 = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(e, a0))); //Set where the path from state k + 32 is strictly better
+		uint32_t d1 = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(o, a1)));
+		__m256i l = _mm256_unpacklo_epi8(e, o), h = _mm256_unpackhi_epi8(e, o); //Unpacking works within 128-bit lanes, the lanes are put in order afterwards
+		m0 = _mm256_permute2x128_si256(l, h, 0x20);
+		m1 = _mm256_permute2x128_si256(l, h, 0x31);
+		dec[i] = d0 | (static_cast<uint64_t>(d1) << 32);
+		if ((t + i) & 1) { //No metric is below the minimum of an earlier step, so nothing is clamped at 0
+			m0 = _mm256_subs_epu8(m0, base);
+			m1 = _mm256_subs_epu8(m1, base);
+			__m256i x = _mm256_min_epu8(m0, m1); //Horizontal minimum: 32 bytes, 16 bytes, then 8 words for phminposuw
+			__m128i y = _mm_min_epu8(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+			y = _mm_minpos_epu16(_mm_min_epu8(y, _mm_srli_epi16(y, 8)));
+			base = _mm256_broadcastb_epi8(y);
+		}
+	}
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(_metric), m0);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(_metric + 32), m1);
+	_base = static_cast<unsigned char>(_mm256_extract_epi8(base, 0));
+#else
+	unsigned char next[64];
+	for (size_t i = 0; i < steps; ++i) {
+		uint64_t d = 0; //Same layout and saturation as the AVX2 version
+		const uint32_t bm = _bm[(q[2 * i] << 5) | q[2 * i + 1]];
+		const int bmk[4] = { static_cast<int>(bm & 255), static_cast<int>((bm >> 8) & 255), static_cast<int>((bm >> 16) & 255), static_cast<int>(bm >> 24) };
+		for (unsigned k = 0; k < 32; ++k) {
+			int m = bmk[_bi[k]];
+			int mc = 62 - m;
+			int a0 = min(_metric[k] + m, 255), b0 = min(_metric[k + 32] + mc, 255);
+			int a1 = min(_metric[k] + mc, 255), b1 = min(_metric[k + 32] + m, 255);
+			next[2 * k] = static_cast<unsigned char>(min(a0, b0));
+			next[2 * k + 1] = static_cast<unsigned char>(min(a1, b1));
+			d |= static_cast<uint64_t>(a0 > b0) << k;
+			d |= static_cast<uint64_t>(a1 > b1) << (k + 32);
+		}
+		dec[i] = d;
+		if ((t + i) & 1) {
+			for (unsigned k = 0; k < 64; ++k) _metric[k] = next[k] - _base;
+			_base = *min_element(_metric, _metric + 64);
+		}
+		else memcpy(_metric, next, sizeof(_metric));
+	}
+#endif
+	_t += steps;
+	return;
+}
+
+void telComSys::VTBD::traceback(unsigned n, size_t from, size_t cnt) {
+	size_t w = _dec.size();
+	size_t info = _frame ? min(from + cnt, static_cast<size_t>(_frame)) : from + cnt; //Tail steps carry no information
+	size_t base = _out.size();
+	if (info > from) _out.resize(base + info - from);
+	const uint64_t* dec = _dec.data(); //Local pointers, the digit stores could alias the members
+	unsigned char* out = _out.data() + base;
+	unsigned r = (n >> 1) | ((n & 1) << 5); //The walk keeps the decision bit index of the state instead of the state itself
+	size_t p = _t % w; //Ring position after the last step, walked down without a division per step
+	size_t t = _t;
+	for (; t > max(info, from); --t) { //Predecessor of state n is n / 2 + 32 * decision, its index follows from the index of n
+		p = p ? p - 1 : w - 1;
+		r = ((r >> 1) & 15) | ((r & 1) << 5) | (static_cast<unsigned>((dec[p] >> r) & 1) << 4);
+	}
+	for (; t > from; --t) {
+		p = p ? p - 1 : w - 1;
+		out[t - 1 - from] = static_cast<unsigned char>(r >> 5); //Newest information digit of state n is its lowest bit
+		r = ((r >> 1) & 15) | ((r & 1) << 5) | (static_cast<unsigned>((dec[p] >> r) & 1) << 4);
+	}
+	return;
+}
+
+void telComSys::VTBD::runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) {
+	size_t length = static_cast<size_t>(round(digTimeSlot / sampInterval));
+	size_t slots = s.size() / length;
+	const double* src = s.data(); //Soft values to decode, one per slot
+	size_t stride = length, cnt = slots;
+	if (!_started) { //Frame alignment of the code digits, the stream is continuous after that
+		for (size_t j = 0; j < slots; ++j) {
+			_startS.push_back(s[j * length]);
+		}
+		_startRef.insert(_startRef.end(), _initS.begin(), _initS.begin() + min(slots, _initS.size()));
+		_pendInfo.insert(_pendInfo.end(), _infoS.begin(), _infoS.end());
+		_infoS.clear();
+		unsigned d = 0;
+		bool ready = _startS.size() >= 64 && _startRef.size() >= _startS.size(); //Short blocks are collected until the delay can be found
+		bool found = ready && cachedDelay(_key, _startRef, sigView(_startS), 1, d);
+		if (!ready || (!found && !_flush && _startS.size() < 4096 + 1024) || d + 64 > _startS.size()) { //Without a clear peak, until estDelay would look at no more slots
+			_preS.clear();
+			for (size_t i = 0; i < s.size(); ++i) s[i] = -1;
+			return;
+		}
+		_delay = d;
+		src = _startS.data() + _delay;
+		stride = 1;
+		cnt = _startS.size() - _delay;
+		_started = true;
+	}
+	_preS.resize(slots > _delay ? slots - _delay : 0); //Indices below stay within the slots, so the checks of at() are not needed
+	size_t p = cnt; //Soft values before the first code digit of the block
+	if (src == s.data()) p = min(_delay, cnt);
+	else { //In the first block the soft values come from the start buffer
+		for (size_t i = 0; i < _preS.size(); ++i) {
+			_preS[i] = s[(i + _delay) * length] >= 0 ? 1 : -1;
+		}
+	}
+	_pendInfo.insert(_pendInfo.end(), _infoS.begin(), _infoS.end());
+	if (!_absN) { //No scale from the previous blocks yet
+		for (size_t i = 0; i < min(cnt, static_cast<size_t>(1024)); ++i) _absSum += abs(src[i * stride]);
+		_absN = static_cast<double>(min(cnt, static_cast<size_t>(1024)));
+	}
+	double scale = _absSum > 0 ? 8 * _absN / _absSum : 0; //The mean magnitude is 8 levels from the middle
+	size_t h = _half >= 0 ? 1 : 0;
+	_q.resize(h + cnt);
+	unsigned char* q = _q.data() + h;
+	if (h) _q[0] = static_cast<unsigned char>(_half);
+	double a = 0; //Magnitudes, quantization and decisions at the decoder input in one pass over the block
+	for (size_t j = 0; j < p; ++j) {
+		a += abs(src[j * stride]);
+		q[j] = level(src[j * stride], scale);
+	}
+	double* pre = _preS.data(); //Local pointer, the byte stores could alias the member
+	for (size_t j = p; j < cnt; ++j) {
+		double x = src[j * stride];
+		a += abs(x);
+		q[j] = level(x, scale);
+		pre[j - p] = 2. * (x >= 0) - 1;
+	}
+	_absSum += a;
+	_absN += cnt;
+	if (_absN > 65536) { //The scale follows the recent values
+		_absSum /= 2;
+		_absN /= 2;
+	}
+	_half = -1;
+	if (_q.size() % 2) {
+		_half = _q.back();
+		_q.pop_back();
+	}
+	size_t w = _dec.size();
+	for (size_t i = 0; i < _q.size() / 2;) {
+		size_t n = min(_q.size() / 2 - i, w - _t % w); //Steps up to the next traceback or the end of the ring
+		n = min(n, w - (_t - _done));
+		if (_frame) n = min(n, _frame + 6 - _t);
+		acs(_q.data() + 2 * i, n);
+		i += n;
+		if (_frame && _t == _frame + 6) { //The tail has brought the encoder to the zero state, the whole frame is decided
+			traceback(0, _done, _t - _done);
+			reset();
+		}
+		else if (_t - _done == w) { //The window is full, its oldest part has merged into one path
+			traceback(static_cast<unsigned>(min_element(_metric, _metric + 64) - _metric), _done, _chunk);
+			_done += _chunk;
+		}
+	}
+	if (_flush && _t > _done) { //No block follows, so the digits still in the window are decided by the best path now
+		traceback(static_cast<unsigned>(min_element(_metric, _metric + 64) - _metric), _done, _t - _done);
+		_done = _t;
+	}
+	size_t k = min(min(_out.size(), _pendInfo.size()), slots); //Decoded digits lag behind the block by up to the traceback window
+	for (size_t j = 0; j < slots; ++j) {
+		double v = j < k ? 2. * _out[j] - 1 : -1; //Branch-free, the digits are random
+		for (size_t l = 0; l < length; ++l) {
+			s[j * length + l] = v;
+		}
+	}
+	_infoS.assign(_pendInfo.begin(), _pendInfo.begin() + k);
+	_out.erase(_out.begin(), _out.begin() + k);
+	_pendInfo.erase(_pendInfo.begin(), _pendInfo.begin() + k);
+	if (!_startS.empty()) { //Not needed once the delay is known
+		vector<double>().swap(_startS);
+		vector<double>().swap(_startRef);
+	}
+	return;
+}
+
+unsigned telComSys::VTBD::rate(unsigned length) {
+	return 1;
+}
+
+void telComSys::VTBD::runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) {
+	runEl(endTime, symTimeSlot, symTimeSlot, s);
+	return;
+}
+
 bool telComSys::cmpd(double lhs, double rhs) {
 	return (abs(lhs - rhs) < 0.000001);
 }
@@ -312,14 +1154,58 @@ telComSys::telComSys(double endTime, double digTimeSlot, double sampInterval) :
 	if (endTime <= 0 || digTimeSlot <= 0 || sampInterval <= 0) throw "Error: all parameters must be positive";
 	if (!checkForMltpl(endTime, digTimeSlot)) throw "Error: modeling end time must be a multiple of digit time slot";
 	if (!checkForMltpl(digTimeSlot, sampInterval)) throw "Error: digit time slot must be a multiple of sample interval";
-	srand(static_cast<unsigned>(time(nullptr)));
+	_dre.seed(random_device()());
 	_s.resize(static_cast<size_t>(endTime / sampInterval));
+	_rate = static_cast<unsigned>(round(digTimeSlot / sampInterval));
+	_cplx = false;
+	_bps = 1;
+	_sps = 1;
+	return;
+}
+
+telComSys::~telComSys() {
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		delete _queue.at(i).first;
+	}
+}
+
+void telComSys::resample(unsigned rate) {
+	if (rate == _rate) return;
+	size_t slots = _s.size() / _rate;
+	if (rate > _rate) { //Interpolation, zero-order hold matches the rectangular digit pulse
+		if (rate % _rate) throw "Error: sample rates must be multiples of each other";
+		unsigned k = rate / _rate;
+		_s.resize(slots * rate);
+		for (size_t i = slots * _rate; i-- > 0;) { //Going backwards allows to expand in place
+			for (unsigned j = 0; j < k; ++j) {
+				_s[i * k + j] = _s[i];
+			}
+		}
+	}
+	else { //Decimation, integrate-and-dump is the filter matched to the rectangular digit pulse
+		if (_rate % rate) throw "Error: sample rates must be multiples of each other";
+		unsigned k = _rate / rate;
+		for (size_t i = 0; i < slots * rate; ++i) {
+			double sum = 0;
+			for (unsigned j = 0; j < k; ++j) {
+				sum += _s[i * k + j];
+			}
+			_s[i] = sum / k;
+		}
+		_s.resize(slots * rate);
+	}
+	_rate = rate;
 	return;
 }
 
 void telComSys::initAWNG() {
 	double sigma = read_double("Enter noise deviation: ", 0., 500.);
-	AWGNG* ptr = new AWGNG(sigma);
+	initAWNG(sigma);
+	return;
+}
+
+void telComSys::initAWNG(double sigma) {
+	AWGNG* ptr = new AWGNG(sigma, _sampInterval, static_cast<unsigned>(_dre()));
 	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::AWGNG));
 	return;
 }
@@ -338,14 +1224,21 @@ void telComSys::initCRTR() {
 		cout << "Enter coefficient for path " << 2 - i + 1 << ": ";
 		coeffs.push_back(read_double("", -15, +15));
 	}
-	CRTR* ptr = new CRTR(c, n, coeffs);
+	initCRTR(c, n, coeffs);
+	return;
+}
+
+void telComSys::initCRTR(char type, unsigned num, vector<double> coeffs) {
+	if ((type != 'R' && type != 'N') || coeffs.size() != 2) throw "Error: invalid corrector parameters";
+	CRTR* ptr = new CRTR(type, num, coeffs);
 	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::CRTR));
 	return;
 }
 
 void telComSys::initDMDL() {
-	int t = read_int("Choose modulation type (for demodulator):\n1. Amplitude\n2. Phase\n3. Frequency\n4. Phase (low frequency)\n", 1, 4);
+	int t = read_int("Choose modulation type (for demodulator):\n1. Amplitude\n2. Phase\n3. Frequency\n4. Phase (low frequency)\n5. BPSK (complex baseband)\n6. QPSK (complex baseband)\n7. 16-QAM (complex baseband)\n8. 64-QAM (complex baseband)\n", 1, 8);
 	char c = 0;
+	unsigned bits = 1;
 	switch (t) {
 	case 1:
 		c = 'A';
@@ -359,22 +1252,45 @@ void telComSys::initDMDL() {
 	case 4:
 		c = 'p';
 		break;
+	case 5:
+		c = 'B';
+		break;
+	case 6:
+	case 7:
+	case 8:
+		c = 'Q';
+		bits = 2 * static_cast<unsigned>(t - 5);
+		break;
 	default:
 		throw "Error: invalid modulation type";
 	}
-	DMDL* ptr = new DMDL(c);
+	initDMDL(c, bits);
+	return;
+}
+
+void telComSys::initDMDL(char type, unsigned bits) {
+	if ((type == 'B' || type == 'Q') != _cplx || bits != _bps) throw "Error: demodulator doesn't match the modulator";
+	DMDL* ptr = new DMDL(type, bits);
 	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::DMDL));
 	return;
 }
 
 void telComSys::initERC() {
-	_queue.push_back(pair<element*, elTypes>(nullptr, elTypes::ERC));
+	ERC* ptr = new ERC(0, _initS, _infoS, _preS, _bps, true, coded()); //The delay is estimated when the system is run
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::ERC));
+	return;
+}
+
+void telComSys::initERC(unsigned delay) {
+	ERC* ptr = new ERC(delay, _initS, _infoS, _preS, _bps, false, coded());
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::ERC));
 	return;
 }
 
 void telComSys::initMDL() {
-	int t = read_int("Choose modulation type:\n1. Amplitude\n2. Phase\n3. Frequency\n", 1, 3);
+	int t = read_int("Choose modulation type:\n1. Amplitude\n2. Phase\n3. Frequency\n4. BPSK (complex baseband)\n5. QPSK (complex baseband)\n6. 16-QAM (complex baseband)\n7. 64-QAM (complex baseband)\n", 1, 7);
 	char c = 0;
+	unsigned bits = 1;
 	switch (t) {
 	case 1:
 		c = 'A';
@@ -385,10 +1301,32 @@ void telComSys::initMDL() {
 	case 3:
 		c = 'F';
 		break;
+	case 4:
+		c = 'B';
+		break;
+	case 5:
+	case 6:
+	case 7:
+		c = 'Q';
+		bits = 2 * static_cast<unsigned>(t - 4);
+		break;
 	default:
 		throw "Error: invalid modulation type";
 	}
-	MDL* ptr = new MDL(c);
+	unsigned sps = 1;
+	if (c == 'B' || c == 'Q') sps = static_cast<unsigned>(read_int("Enter samples per symbol: ", 1, 64));
+	initMDL(c, bits, sps);
+	return;
+}
+
+void telComSys::initMDL(char type, unsigned bits, unsigned sps) {
+	if (type == 'B' || type == 'Q') { //The whole system switches to complex baseband
+		if (!sps) throw "Error: invalid number of samples per symbol";
+		_cplx = true;
+		_bps = bits;
+		_sps = sps;
+	}
+	MDL* ptr = new MDL(type, bits);
 	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::MDL));
 	return;
 }
@@ -400,18 +1338,101 @@ void telComSys::initMPCH() {
 		cout << "Enter coefficient for path " << n - i + 1 << ": ";
 		coeffs.push_back(read_double("", -15, +15));
 	}
-	MPCH* ptr = new MPCH(n, coeffs);
+	initMPCH(coeffs);
+	return;
+}
+
+void telComSys::initMPCH(vector<double> coeffs) {
+	if (coeffs.empty()) throw "Error: multipath channel needs at least one path";
+	MPCH* ptr = new MPCH(static_cast<unsigned>(coeffs.size()), coeffs);
 	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::MPCH));
 	return;
 }
 
 void telComSys::initRTSG() {
 	double p = read_double("Enter probability of '1': ", 0., 1.);
-	RTSG* ptr = new RTSG(p);
+	initRTSG(p);
+	return;
+}
+
+void telComSys::initRTSG(double prob1) {
+	RTSG* ptr = new RTSG(prob1, static_cast<unsigned>(_dre()));
 	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::RTSG));
 	return;
 }
 
+void telComSys::initSPAN() {
+	size_t n = static_cast<size_t>(read_int("Enter FFT size (power of 2): ", 2, 65536));
+	double o = read_double("Enter segment overlap (fraction of FFT size): ", 0., 0.95);
+	initSPAN(n, o);
+	return;
+}
+
+void telComSys::initSPAN(size_t size, double overlap) {
+	SPAN* ptr = new SPAN(size, overlap);
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::SPAN));
+	return;
+}
+
+void telComSys::initFSRC() {
+	char sig[256];
+	char ref[256];
+	read_str("Enter recorded signal file: ", sig, sizeof(sig));
+	read_str("Enter reference digits file (empty if none): ", ref, sizeof(ref));
+	initFSRC(sig, ref[0] ? ref : nullptr);
+	return;
+}
+
+void telComSys::initFSRC(const char* sigPath, const char* refPath) {
+	FSRC* ptr = new FSRC(sigPath, refPath, _initS);
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::FSRC));
+	return;
+}
+
+void telComSys::initFDCH() {
+	unsigned n = static_cast<unsigned>(read_int("Enter the number of paths: ", 1, 8));
+	vector<double> coeffs;
+	for (auto i = n; i > 0; --i) {
+		cout << "Enter coefficient for path " << n - i + 1 << ": ";
+		coeffs.push_back(read_double("", -15, +15));
+	}
+	double fd = read_double("Enter maximum Doppler frequency: ", 0., 1000.);
+	double k = read_double("Enter Rician K factor of the first path (0 for Rayleigh): ", 0., 100.);
+	initFDCH(coeffs, fd, k);
+	return;
+}
+
+void telComSys::initFDCH(vector<double> coeffs, double doppler, double kFactor) {
+	FDCH* ptr = new FDCH(coeffs, doppler, kFactor, static_cast<unsigned>(_dre()));
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::FDCH));
+	return;
+}
+
+void telComSys::initCNVE() {
+	unsigned f = static_cast<unsigned>(read_int("Enter frame length in information digits (0 for a continuous stream): ", 0, 1000000));
+	initCNVE(f);
+	return;
+}
+
+void telComSys::initCNVE(unsigned frame) {
+	CNVE* ptr = new CNVE(_infoS, frame);
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::CNVE));
+	return;
+}
+
+void telComSys::initVTBD() {
+	CNVE* enc = nullptr;
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		if (_queue.at(i).second == elTypes::CNVE) enc = static_cast<CNVE*>(_queue.at(i).first);
+	}
+	if (!enc) throw "Error: Viterbi decoder needs an encoder before it";
+	if (_queue.empty() || _queue.back().second != elTypes::DMDL) throw "Error: Viterbi decoder needs a demodulator before it";
+	static_cast<DMDL*>(_queue.back().first)->_soft = true; //Soft decisions are taken from the integrator
+	VTBD* ptr = new VTBD(_initS, _infoS, _preS, enc->_frame); //Frames of the encoder are terminated, so the decoder flushes at their ends
+	_queue.push_back(pair<element*, elTypes>(ptr, elTypes::VTBD));
+	return;
+}
+
 void telComSys::appendToQueue(elTypes type) {
 	switch (type) {
 	case elTypes::AWGNG:
@@ -435,6 +1456,21 @@ void telComSys::appendToQueue(elTypes type) {
 	case elTypes::RTSG:
 		initRTSG();
 		break;
+	case elTypes::SPAN:
+		initSPAN();
+		break;
+	case elTypes::FSRC:
+		initFSRC();
+		break;
+	case elTypes::FDCH:
+		initFDCH();
+		break;
+	case elTypes::CNVE:
+		initCNVE();
+		break;
+	case elTypes::VTBD:
+		initVTBD();
+		break;
 	default:
 		throw "Error: invalid element type";
 		break;
@@ -442,16 +1478,114 @@ void telComSys::appendToQueue(elTypes type) {
 	return;
 }
 
+bool telComSys::coded() {
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		if (_queue.at(i).second == elTypes::VTBD) return true;
+	}
+	return false;
+}
+
+void telComSys::setKeys() {
+	string key;
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		key += to_string(static_cast<int>(_queue.at(i).second)) + ':' + _queue.at(i).first->cfgKey() + ';';
+		_queue.at(i).first->_key = key;
+	}
+	return;
+}
+
 void telComSys::run() {
+	if (_cplx) {
+		if (static_cast<size_t>(round(_endTime / _digTimeSlot)) % _bps) throw "Error: number of digit time slots must be a multiple of bits per symbol";
+		resample(1); //Bits stay at one sample per slot, the symbols are carried by _cs
+	}
+	setKeys();
+	unsigned length = static_cast<unsigned>(round(_digTimeSlot / _sampInterval));
+	std::vector<unsigned> later(_queue.size() + 1, 0); //Highest rate needed by the elements after each one
+	for (size_t i = _queue.size(); i--;) later.at(i) = std::max(later.at(i + 1), _queue.at(i).first->rate(length));
 	for (size_t i = 0; i < _queue.size(); ++i) {
-		if (_queue.at(i).second == elTypes::ERC) {
-			unsigned u = static_cast<unsigned>(read_int("Enter system's overall delay: ", 0, static_cast<int>(_endTime / _digTimeSlot)));
-			_queue.at(i).first = new ERC(u, _initS);
+		if (_cplx) _queue.at(i).first->runElC(_endTime, _digTimeSlot * _bps, _digTimeSlot * _bps / _sps, _s, _cs);
+		else {
+			unsigned r = _queue.at(i).first->rate(length);
+			if (!r && later.at(i + 1) > _rate) r = later.at(i + 1); //Held samples of noise or fading aren't the same as generating them at the higher rate
+			if (r) resample(r); //Elements which don't need oversampling run at one sample per slot
+			if (_queue.at(i).second == elTypes::VTBD) static_cast<VTBD*>(_queue.at(i).first)->_flush = true; //The whole signal is one block
+			_queue.at(i).first->runEl(_endTime, _digTimeSlot, _digTimeSlot / _rate, _s);
 		}
-		_queue.at(i).first->runEl(_endTime, _digTimeSlot, _sampInterval, _s);
-		if (_queue.at(i).second == elTypes::RTSG) _initS = _s;
+		if (_queue.at(i).second == elTypes::RTSG || _queue.at(i).second == elTypes::CNVE) _initS = _s; //With channel coding the code digits are the reference
 		if (_queue.at(i).second == elTypes::RTSG) printSignal();
+		if (_queue.at(i).second == elTypes::ERC) static_cast<ERC*>(_queue.at(i).first)->print();
+		if (_queue.at(i).second == elTypes::SPAN) static_cast<SPAN*>(_queue.at(i).first)->print();
+	}
+}
+
+void telComSys::process(double* s, size_t n) {
+	if (_cplx) throw "Error: complex baseband mode can't run on a caller-owned buffer";
+	size_t length = static_cast<size_t>(round(_digTimeSlot / _sampInterval));
+	if (!n || n % length) throw "Error: buffer length must be a multiple of digit time slot";
+	double endTime = n * _sampInterval;
+	setKeys();
+	for (size_t i = 0; i < _queue.size(); ++i) { //The buffer keeps its rate, so no element needs a copy of it
+		_queue.at(i).first->runEl(endTime, _digTimeSlot, _sampInterval, sigView(s, n));
+		if (_queue.at(i).second == elTypes::RTSG || _queue.at(i).second == elTypes::CNVE) {
+			_initS.resize(n / length);
+			for (size_t j = 0; j < _initS.size(); ++j) {
+				_initS[j] = s[j * length];
+			}
+		}
+	}
+	return;
+}
+
+void telComSys::process(const double* in, double* out, size_t n) {
+	if (in != out) copy(in, in + n, out);
+	process(out, n);
+	return;
+}
+
+telComSys::ERC* telComSys::lastERC() {
+	for (size_t i = _queue.size(); i-- > 0;) {
+		if (_queue.at(i).second == elTypes::ERC && _queue.at(i).first) return static_cast<ERC*>(_queue.at(i).first);
+	}
+	throw "Error: no error counter in the system";
+}
+
+unsigned telComSys::errCount() {
+	return lastERC()->_cnt;
+}
+
+size_t telComSys::checkedCount() {
+	return lastERC()->_n;
+}
+
+unsigned telComSys::preErrCount() {
+	return lastERC()->_preCnt;
+}
+
+size_t telComSys::preCheckedCount() {
+	return lastERC()->_preN;
+}
+
+unsigned telComSys::symErrCount() {
+	return lastERC()->_symCnt;
+}
+
+unsigned telComSys::delay() {
+	return lastERC()->_delay;
+}
+
+vector<pair<double, double>> telComSys::psd() {
+	for (size_t i = _queue.size(); i-- > 0;) {
+		if (_queue.at(i).second == elTypes::SPAN && _queue.at(i).first) return static_cast<SPAN*>(_queue.at(i).first)->bins();
+	}
+	throw "Error: no spectrum analyzer in the system";
+}
+
+bool telComSys::srcExhausted() {
+	for (size_t i = 0; i < _queue.size(); ++i) {
+		if (_queue.at(i).second == elTypes::FSRC && static_cast<FSRC*>(_queue.at(i).first)->_end) return true;
 	}
+	return false;
 }
 
 void telComSys::printSignal() {
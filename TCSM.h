@@ -1,10 +1,19 @@
 #pragma once
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <algorithm>
 #include <vector>
 #include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
 #include <random>
 #include <utility>
 #include "io.h"
+#include "mfile.h"
 
 using namespace std;
 
@@ -16,6 +25,36 @@ enum class elTypes { //Types of available elements
 	ERC,
 	MPCH,
 	CRTR,
+	SPAN,
+	FSRC,
+	FDCH,
+	CNVE,
+	VTBD,
+};
+
+class sigView { //Non-owning view of a signal buffer, elements change it in place
+private:
+
+	double* _data;
+
+	size_t _size;
+
+public:
+
+	sigView(double* data, size_t size) : _data(data), _size(size) {}
+
+	sigView(vector<double>& v) : _data(v.data()), _size(v.size()) {}
+
+	double& at(size_t i) {
+		if (i >= _size) throw "Error: signal index out of range";
+		return _data[i];
+	}
+
+	double& operator[](size_t i) { return _data[i]; }
+
+	size_t size() const { return _size; }
+
+	double* data() { return _data; }
 };
 
 class telComSys {
@@ -29,14 +68,74 @@ private:
 
 	vector<double> _s; //Main signal
 
-	vector<double> _initS; //Initial signal (after RTSG)
+	vector<double> _initS; //Initial signal (after RTSG, or after CNVE with channel coding)
+
+	vector<double> _infoS; //Information digits before the encoder, one per digit time slot
+
+	vector<double> _preS; //Decisions at the decoder input, aligned with _initS
 
 	vector<double> _gammas; //Coefficients for multipath channel
 
+	default_random_engine _dre; //Source of seeds for the random elements, each system has its own
+
+	vector<complex<double>> _cs; //Complex envelope of the main signal (complex baseband mode)
+
+	bool _cplx; //Complex baseband mode
+
+	unsigned _bps; //Bits per symbol in complex baseband mode
+
+	unsigned _sps; //Samples per symbol in complex baseband mode
+
+	static void fft(vector<complex<double>>& a, bool inverse = false); //In-place radix-2 fast Fourier transform
+
+	static vector<complex<double>> constellation(unsigned bits); //Gray-mapped BPSK or square QAM points with unit average energy
+
+	static map<string, unsigned> _delays; //Estimated delays for each chain configuration
+
+	static mutex _delaysMtx;
+
+	static bool estDelay(const vector<double>& initS, sigView s, size_t length, unsigned& delay); //Delay between the initial signal and s, in digit time slots, by FFT cross-correlation; false if the peak doesn't stand out
+
+	static bool cachedDelay(const string& key, const vector<double>& initS, sigView s, size_t length, unsigned& delay); //estDelay, cached for each chain configuration once it is reliable
+
+	static unsigned parity(unsigned x); //Parity of the set bits
+
+	class carrier { //Sine carrier generated sample by sample, its phase continues from one block to the next
+	public:
+
+		double _freq; //Angular frequency
+
+		complex<double> _ph; //Current phasor, the carrier is its imaginary part
+
+		complex<double> _rot; //Rotation per sample
+
+		carrier(double freq);
+
+		void start(double sampInterval); //Sets the rotation for the block's sample interval
+
+		double next() { //Carrier sample, then advances the phase
+			double v = _ph.imag();
+			_ph *= _rot;
+			return v;
+		}
+	};
+
 	class element {
 	public:
 
-		virtual void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s) = 0; //Function which models change to the main signal
+		virtual void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s) = 0; //Function which models change to the main signal
+
+		virtual unsigned rate(unsigned length) { return length; } //Samples per digit time slot the element needs, 0 if it can run at any rate
+
+		virtual void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs) { //Complex baseband counterpart of runEl, s holds one bit per digit time slot
+			throw "Error: element is not available in complex baseband mode";
+		}
+
+		virtual string cfgKey() { return ""; } //Parameters of the element which may change the delay in the system
+
+		virtual ~element() {}
+
+		string _key; //Configuration of the chain up to and including the element
 
 	};
 
@@ -45,9 +144,15 @@ private:
 
 		double _prob1; //Probability of 1
 
-		RTSG(double prob1);
+		default_random_engine _dre;
+
+		RTSG(double prob1, unsigned seed);
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs);
 	};
 
 	class AWGNG : public element { //Additive white gaussian noise generator
@@ -55,9 +160,17 @@ private:
 
 		double _deviation; //Standard deviation of gaussian noise
 
-		AWGNG(double sigma);
+		double _sampInterval; //Sample interval the deviation is given for
+
+		default_random_engine _dre;
+
+		AWGNG(double sigma, double sampInterval, unsigned seed);
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs);
 	};
 
 	class MDL : public element { //Modulator
@@ -65,23 +178,29 @@ private:
 
 		char _type; //Modulation type
 
-		vector<double> _carrier; //Carrier signal
+		carrier _carrier; //Carrier signal
+
+		carrier _carrier2; //Second carrier signal for FM
+
+		unsigned _bits; //Bits per symbol for complex baseband modulations
 
-		vector<double> _carrier2; //Second carrier signal for FM
+		vector<complex<double>> _points; //Constellation points indexed by bit pattern
 
-		MDL(char type);
+		MDL(char type, unsigned bits = 1);
 
-		void carrierInit(double endTime, double sampInterval); //Initialization of the carrier signal
+		void carrierInit(double sampInterval); //Prepares the carriers for the block
 
-		void carriersInitFM(double endTime, double sampInterval); //Initialization of the second carrier signal for FM
+		void AM(double endTime, double digTimeSlot, double sampInterval, sigView s); //Modulation functions for corresponding modulation types
 
-		void AM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s); //Modulation functions for corresponding modulation types
+		void FM(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void FM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		void PM(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void PM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs); //Maps groups of bits onto BPSK or QAM symbols
+
+		string cfgKey();
 	};
 
 	class DMDL : public element { //Demodulator
@@ -89,27 +208,39 @@ private:
 
 		char _type; //Modulation type
 
-		vector<double> _carrier; //Carrier signals for different modulation types
+		bool _soft; //Whether the integrator value is output instead of the decision (for a decoder)
+
+		vector<double> _lastSlot; //Samples of the last slot of the previous block, its decision goes to the first slot of the next one
+
+		carrier _carrier; //Carrier signals for different modulation types, in step with the modulator's
+
+		carrier _carrier2;
+
+		unsigned _bits; //Bits per symbol for complex baseband modulations
+
+		DMDL(char type, unsigned bits = 1);
+
+		void carrierInit(double sampInterval); //Prepares the carriers for the block
 
-		vector<double> _carrier2;
+		void output(double thresholdLevel, double digTimeSlot, double sampInterval, sigView s); //Integrator and decision-making device
 
-		DMDL(char type);
+		void decide(double sum, sigView s, size_t first, size_t length); //Writes the decision (or the soft value) for an integrated slot
 
-		void carrierInit(double endTime, double sampInterval); //Initialization of the carrier signal for AM and PH
+		void AM(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void carriersInitFM(double endTime, double sampInterval); //Initialization of the carrier signal for FM
+		void FM(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void output(double thresholdLevel, double digTimeSlot, double sampInterval, vector<double>& s); //Integrator and decision-making device
+		void PM(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void AM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		void pM(double endTime, double digTimeSlot, double sampInterval, sigView s); //Low-frequency phase modulation
 
-		void FM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
 
-		void PM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		unsigned rate(unsigned length);
 
-		void pM(double endTime, double digTimeSlot, double sampInterval, vector<double>& s); //Low-frequency phase modulation
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs); //Integrate-and-dump and per-axis slicing back to bits
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		string cfgKey();
 	};
 
 	class ERC : public element { //Error counter
@@ -119,11 +250,39 @@ private:
 
 		unsigned _delay; //Total delay in the system, in digit time slots
 
-		vector<double> _initS; //Initial signal (after RTSG)
+		const vector<double>& _initS; //Initial signal (after RTSG), owned by the system
 
-		ERC(unsigned delay, vector<double> initS);
+		const vector<double>& _infoS; //Information digits, for the error rate after decoding
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		const vector<double>& _preS; //Decisions at the decoder input, empty without channel coding
+
+		unsigned _preCnt; //Errors before decoding
+
+		size_t _preN; //Digits checked before decoding
+
+		size_t _n; //Digits checked
+
+		unsigned _bps; //Bits per symbol
+
+		unsigned _symCnt; //Symbols with at least one wrong bit
+
+		bool _est; //Whether the delay is estimated instead of given
+
+		bool _coded; //Whether a decoder comes before the counter
+
+		vector<double> _pend; //Reference digits of the previous blocks whose delayed counterparts haven't arrived yet
+
+		size_t _base; //Number of reference digits before the first one in _pend, for the symbol boundaries
+
+		ERC(unsigned delay, const vector<double>& initS, const vector<double>& infoS, const vector<double>& preS, unsigned bps = 1, bool est = false, bool coded = false);
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
+
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs);
+
+		void print();
 	};
 
 	class MPCH : public element { //Mutipath channel
@@ -131,13 +290,25 @@ private:
 
 		unsigned _num; //Number of paths
 
-		vector<vector<double>> _sig; //Signals on each path
-
 		vector<double> _gammas; //Coefficients
 
+		vector<complex<double>> _hist; //Last input samples, for the delayed paths
+
+		size_t _pos; //Position of the newest sample in _hist
+
+		size_t _length; //Samples per digit time slot _hist is kept for
+
 		MPCH(unsigned num, vector<double> coeffs);
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		void history(size_t length); //Prepares the delay line
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
+
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs); //Paths are delayed by whole symbols
+
+		string cfgKey();
 	};
 
 	class CRTR : public element { //Corrector
@@ -147,21 +318,241 @@ private:
 
 		unsigned _num; //Number of elements in non-recursive corrector
 
-		vector<vector<double>> _sig; //Signals on each branch of non-recursive corrector
-
 		vector<double> _gammas; //Coefficients
 
+		double _val; //Current value in the recursive corrector
+
+		vector<double> _hist; //Last input samples of the non-recursive corrector
+
+		size_t _pos; //Position of the newest sample in _hist
+
+		size_t _length; //Samples per digit time slot _hist is kept for
+
 		CRTR(char type, unsigned num, vector<double> coeffs);
 
-		void recCRTR(size_t length, vector<double>& s, double val = 0, unsigned depth = 0);
+		void recCRTR(size_t length, sigView s);
+
+		void nrCRTR(size_t length, sigView s);
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
+
+		unsigned rate(unsigned length);
+
+		string cfgKey();
+	};
+
+	class SPAN : public element { //Spectrum analyzer (Welch power spectral density estimate)
+	public:
+
+		size_t _size; //FFT size
+
+		size_t _hop; //Distance between the starts of neighbouring segments
+
+		vector<double> _window; //Hann window
+
+		vector<complex<double>> _buf; //Windowed segment and its spectrum
+
+		vector<complex<double>> _tail; //Samples of the previous blocks from the start of the first segment not completed yet, fewer than _size
+
+		vector<double> _acc; //Accumulated periodograms
+
+		size_t _segs; //Number of accumulated segments
+
+		double _sampInterval; //Sample interval of the analyzed signal
+
+		bool _cplx; //Whether the analyzed signal is complex, its spectrum is two-sided then
+
+		SPAN(size_t size, double overlap);
+
+		void restart(double sampInterval, bool cplx); //Drops the accumulated spectrum and the tail if the signal changed
+
+		void accumulate(const double* x, const complex<double>* cx, size_t n); //Adds the periodograms of the segments completed by a block of n real (x) or complex (cx) samples, keeps the rest in _tail
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s); //Passes the signal through unchanged
+
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs);
+
+		vector<pair<double, double>> bins(); //Frequency and power spectral density of each bin, empty before the first segment
+
+		void print(); //Prints the PSD bins
+	};
+
+	class FSRC : public element { //Recorded signal source, each run reads the next block of the recording
+	public:
+
+		mappedFile _sig; //Raw samples (native doubles) taken at the system's sample interval
+
+		unique_ptr<mappedFile> _ref; //Reference digits, one byte per digit time slot, nonzero for 1 (optional)
 
-		void nrCRTR(size_t length, vector<double>& s);
+		unsigned long long _pos; //Digit time slots already read
 
-		void runEl(double endTime, double digTimeSlot, double sampInterval, vector<double>& s);
+		bool _end; //Whether the whole recording has been read
+
+		vector<double>& _initS; //Initial signal of the system, filled from the reference digits
+
+		string _paths; //Files of the recording, the delay comes from them rather than from the chain
+
+		FSRC(const char* sigPath, const char* refPath, vector<double>& initS);
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s);
+
+		string cfgKey();
+	};
+
+	class FDCH : public element { //Fading channel, paths have time-varying Rayleigh or Rician gains (sum-of-sinusoids model)
+	public:
+
+		vector<double> _gammas; //Average amplitude of each path
+
+		double _doppler; //Maximum Doppler frequency
+
+		double _kFactor; //Rician K factor of the first path, 0 for Rayleigh fading
+
+		unsigned _sins; //Sinusoids per quadrature component of each path
+
+		vector<double> _freq; //Angular frequency of each oscillator
+
+		vector<complex<double>> _osc; //Oscillators, kept as rotating phasors so no trigonometric functions are called per sample
+
+		vector<complex<double>> _rot; //Rotation of each oscillator over one step
+
+		double _step; //Time step _rot is computed for
+
+		unsigned _steps; //Steps since the oscillators were last normalized
+
+		vector<complex<double>> _g; //Path gains at the start of the current block
+
+		vector<complex<double>> _gEnd; //Path gains at the end of the current block
+
+		vector<complex<double>> _hist; //Last input samples, for the delayed paths
+
+		size_t _pos; //Position of the newest sample in _hist
+
+		size_t _length; //Samples per digit time slot _hist is kept for
+
+		FDCH(vector<double> coeffs, double doppler, double kFactor, unsigned seed, unsigned sins = 8);
+
+		void gains(vector<complex<double>>& g); //Path gains for the current state of the oscillators
+
+		void advance(double step); //Moves the oscillators forward in time and computes _gEnd
+
+		size_t blockSize(double sampInterval); //Samples between exact gain calculations, gains are linearly interpolated in between
+
+		void history(size_t length); //Prepares the delay line
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s); //Path amplitudes are the envelopes of the gains (coherent reception)
+
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs); //Paths are delayed by whole symbols
+
+		string cfgKey();
+	};
+
+	class CNVE : public element { //Convolutional encoder, rate 1/2, constraint length 7 (generators 133 and 171 octal), the code stream continues across blocks
+	public:
+
+		vector<double>& _infoS; //Information digits of the system, those encoded in the last block
+
+		unsigned _sr; //Shift register, the newest digit is the lowest bit
+
+		unsigned _frame; //Information digits per frame, each frame is followed by 6 zero tail digits; 0 for a continuous stream
+
+		size_t _cnt; //Steps since the start of the frame
+
+		double _pend; //Second code digit of the last step if it didn't fit into the block, 0 if none
+
+		CNVE(vector<double>& infoS, unsigned frame = 0);
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s); //Each information digit taken from the start of the block is replaced by two code digits
+
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs);
+	};
+
+	class VTBD : public element { //Viterbi decoder for the code of CNVE, takes soft values from the demodulator, keeps its paths across blocks
+	public:
+
+		unsigned char _bi[32]; //Expected code digits of the transition from state k to 2k for each butterfly k, as an index into a branch metric table
+
+		uint32_t _bm[1024]; //Branch metrics of the four pairs of expected digits (one byte each) for each pair of 5-bit soft values
+
+		unsigned char _metric[64]; //Path metrics, 8-bit so that all the states fit into two AVX2 registers
+
+		unsigned char _base; //Smallest metric two steps ago, subtracted at the next odd step
+
+		vector<uint64_t> _dec; //Decisions of the last steps (sliding traceback window), bit k for state 2k and bit 32 + k for state 2k + 1
+
+		size_t _depth; //Traceback depth
+
+		size_t _chunk; //Digits output per traceback
+
+		unsigned _frame; //Information digits per frame of the encoder, 0 for a continuous stream
+
+		size_t _t; //Steps since the start of the frame
+
+		size_t _done; //Steps already traced back and output
+
+		bool _flush; //Whether each block is the last one, set by run()
+
+		bool _started; //Whether the delay of the chain has been found
+
+		size_t _delay; //Delay of the chain, in digit time slots
+
+		vector<double> _startS; //Soft values collected until there are enough to find the delay
+
+		vector<double> _startRef; //Code digits of the same slots
+
+		int _half; //Soft value left from the previous block when it ended inside a pair, -1 if none
+
+		vector<unsigned char> _q; //5-bit soft values of the block, 31 is a certain '1'
+
+		double _absSum; //Sum of the magnitudes of the recent soft values, sets the quantizer scale for the next block
+
+		double _absN; //Number of values in _absSum
+
+		vector<unsigned char> _out; //Decoded digits not yet written to the signal
+
+		vector<double> _pendInfo; //Information digits from the encoder not yet matched with decoded ones
+
+		const vector<double>& _initS; //Coded digits of the system
+
+		vector<double>& _infoS; //Information digits, replaced by those matching the decoded digits of the block
+
+		vector<double>& _preS; //Decisions at the decoder input
+
+		VTBD(const vector<double>& initS, vector<double>& infoS, vector<double>& preS, unsigned frame = 0, size_t depth = 64, size_t chunk = 960);
+
+		static unsigned char level(double x, double scale); //5-bit quantization of a soft value
+
+		void reset(); //Starts a new frame from the zero state
+
+		void acs(const unsigned char* q, size_t steps); //Add-compare-select for the given pairs of 5-bit soft values, metrics stay in registers
+
+		void traceback(unsigned n, size_t from, size_t cnt); //Traces back from state n at the last step, outputs the information digits of steps from to from + cnt
+
+		void runEl(double endTime, double digTimeSlot, double sampInterval, sigView s); //Decoded digits are written from the start of the block, the rest of it is -1
+
+		unsigned rate(unsigned length);
+
+		void runElC(double endTime, double symTimeSlot, double sampInterval, sigView s, vector<complex<double>>& cs);
 	};
 
 	vector<pair<element*, elTypes>> _queue; //Queue of the elements in the system
 
+	unsigned _rate; //Current number of samples per digit time slot in the main signal
+
+	void resample(unsigned rate); //Changes the sample rate of the main signal
+
+	void setKeys(); //Fills the configuration keys of the elements in the queue
+
+	bool coded(); //Whether a decoder is already in the queue
+
+	ERC* lastERC(); //Last error counter in the queue, its results are the ones reported
+
 public:
 
 	bool cmpd(double lhs, double rhs); //Floating point values comparison
@@ -170,23 +561,83 @@ public:
 
 	telComSys(double endTime, double digTimeSlot, double sampInterval);
 
+	telComSys(const telComSys&) = delete; //The system owns its elements
+
+	telComSys& operator=(const telComSys&) = delete;
+
+	~telComSys();
+
 	void initAWNG();
 
+	void initAWNG(double sigma); //Non-interactive versions take the element parameters directly
+
 	void initCRTR();
 
+	void initCRTR(char type, unsigned num, vector<double> coeffs);
+
 	void initDMDL();
 
+	void initDMDL(char type, unsigned bits = 1);
+
 	void initERC();
 
+	void initERC(unsigned delay);
+
 	void initMDL();
 
+	void initMDL(char type, unsigned bits = 1, unsigned sps = 1);
+
 	void initMPCH();
 
+	void initMPCH(vector<double> coeffs);
+
 	void initRTSG();
 
+	void initRTSG(double prob1);
+
+	void initSPAN();
+
+	void initSPAN(size_t size, double overlap);
+
+	void initFSRC();
+
+	void initFSRC(const char* sigPath, const char* refPath = nullptr);
+
+	void initFDCH();
+
+	void initFDCH(vector<double> coeffs, double doppler, double kFactor);
+
+	void initCNVE();
+
+	void initCNVE(unsigned frame);
+
+	void initVTBD();
+
 	void appendToQueue(elTypes type);
 
 	void run();
 
+	void process(double* s, size_t n); //Runs the queue in place on a caller-owned buffer of n samples taken at the sample interval
+
+	void process(const double* in, double* out, size_t n);
+
+	unsigned errCount(); //Number of wrong digits found by the last error counter
+
+	size_t checkedCount(); //Number of digits it compared
+
+	unsigned preErrCount(); //Wrong digits at the decoder input, only counted with channel coding
+
+	size_t preCheckedCount();
+
+	unsigned symErrCount(); //Symbols with at least one wrong bit, only counted without channel coding
+
+	unsigned delay(); //Delay used by the last error counter, given or estimated, in digit time slots
+
+	vector<pair<double, double>> psd(); //Frequency and power spectral density of each bin of the last spectrum analyzer, as run() prints them
+
+	bool srcExhausted(); //Whether a recorded signal source has reached the end of its file
+
+	static void clearDelays(); //Forgets the cached delays, e.g. after the channel has changed
+
 	void printSignal();
 };
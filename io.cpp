@@ -99,4 +99,28 @@ double read_double(const char* prompt, double min, double max) {
 		}
 		return (double)n;
 	}
+}
+
+void read_str(const char* prompt, char* str, int size) {
+	while (true) {
+		printf("%s", prompt);
+		if (fgets(str, size, stdin) == NULL) {
+			str[0] = 0;
+			return;
+		}
+		char* nl = strchr(str, '\n');
+		if (nl == NULL) {
+			bool f = true;
+			int c;
+			while ((c = fgetc(stdin)) != '\n' && c != EOF) {
+				f = false;
+			}
+			if (f == false) {
+				printf("The entered string is too large\n");
+				continue;
+			}
+		}
+		else *nl = 0;
+		return;
+	}
 }
\ No newline at end of file
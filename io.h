@@ -2,4 +2,6 @@
 
 int read_int(const char* prompt, int min, int max);
 
-double read_double(const char* prompt, double min, double max);
\ No newline at end of file
+double read_double(const char* prompt, double min, double max);
+
+void read_str(const char* prompt, char* str, int size);
\ No newline at end of file
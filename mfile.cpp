@@ -0,0 +1,101 @@
+#include "mfile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mappedFile::mappedFile(const char* path) : _mapping(NULL), _view(NULL), _viewSize(0), _size(0) {
+	_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_file == INVALID_HANDLE_VALUE) throw "Error: can't open the file";
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size)) {
+		CloseHandle(_file);
+		throw "Error: can't get the file size";
+	}
+	_size = static_cast<unsigned long long>(size.QuadPart);
+	if (_size) {
+		_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_mapping == NULL) {
+			CloseHandle(_file);
+			throw "Error: can't map the file";
+		}
+	}
+}
+
+mappedFile::~mappedFile() {
+	unmap();
+	if (_mapping != NULL) CloseHandle(_mapping);
+	CloseHandle(_file);
+}
+
+void mappedFile::unmap() {
+	if (_view != NULL) UnmapViewOfFile(_view);
+	_view = NULL;
+	_viewSize = 0;
+	return;
+}
+
+const char* mappedFile::view(unsigned long long offset, size_t bytes) {
+	unmap();
+	if (!bytes) return NULL;
+	if (offset + bytes > _size) throw "Error: reading past the end of the file";
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	unsigned long long start = offset - offset % si.dwAllocationGranularity; //Views must start at the allocation granularity
+	size_t shift = static_cast<size_t>(offset - start);
+	_view = MapViewOfFile(_mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start & 0xFFFFFFFF), shift + bytes);
+	if (_view == NULL) throw "Error: can't map the file";
+	_viewSize = shift + bytes;
+	return static_cast<const char*>(_view) + shift;
+}
+
+#else
+
+mappedFile::mappedFile(const char* path) : _view(NULL), _viewSize(0), _size(0) {
+	_fd = open(path, O_RDONLY);
+	if (_fd < 0) throw "Error: can't open the file";
+	struct stat st;
+	if (fstat(_fd, &st) < 0) {
+		close(_fd);
+		throw "Error: can't get the file size";
+	}
+	_size = static_cast<unsigned long long>(st.st_size);
+}
+
+mappedFile::~mappedFile() {
+	unmap();
+	close(_fd);
+}
+
+void mappedFile::unmap() {
+	if (_view != NULL) munmap(_view, _viewSize);
+	_view = NULL;
+	_viewSize = 0;
+	return;
+}
+
+const char* mappedFile::view(unsigned long long offset, size_t bytes) {
+	unmap();
+	if (!bytes) return NULL;
+	if (offset + bytes > _size) throw "Error: reading past the end of the file";
+	unsigned long long page = static_cast<unsigned long long>(sysconf(_SC_PAGESIZE));
+	unsigned long long start = offset - offset % page; //Mapping offset must be page aligned
+	size_t shift = static_cast<size_t>(offset - start);
+	void* p = mmap(NULL, shift + bytes, PROT_READ, MAP_PRIVATE, _fd, static_cast<off_t>(start));
+	if (p == MAP_FAILED) throw "Error: can't map the file";
+	_view = p;
+	_viewSize = shift + bytes;
+	return static_cast<const char*>(_view) + shift;
+}
+
+#endif
+
+unsigned long long mappedFile::size() {
+	return _size;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+
+class mappedFile { //Read-only file which is mapped into memory one window at a time
+private:
+
+#ifdef _WIN32
+	void* _file; //File handle
+
+	void* _mapping; //File mapping object
+#else
+	int _fd; //File descriptor
+#endif
+
+	void* _view; //Currently mapped window
+
+	size_t _viewSize; //Size of the mapped window in bytes
+
+	unsigned long long _size; //File size in bytes
+
+	void unmap();
+
+public:
+
+	mappedFile(const char* path);
+
+	mappedFile(const mappedFile&) = delete;
+
+	mappedFile& operator=(const mappedFile&) = delete;
+
+	~mappedFile();
+
+	unsigned long long size();
+
+	const char* view(unsigned long long offset, size_t bytes); //Maps the given range of the file, the previous window is unmapped
+};